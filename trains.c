@@ -1,13 +1,30 @@
+#define _GNU_SOURCE  // pthread barriers, sigaction and SOCK_NONBLOCK are not part of strict C11
+
+#include <errno.h>
 #include <limits.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdatomic.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 #define INF INT_MAX
 #define MAX_STATIONS 12                   // The amount and names of the stations are fixed, so they are defined as global variables
-char station_names[MAX_STATIONS][20] = {  // Attribute an index to each of the 12 stations (0-11)
+
+#ifdef EMBEDDED_NETWORK
+#include "trainsNetwork.h"  // Station names, compressed graph and all-pairs table generated by --emit-tables
+#else
+const char station_names[MAX_STATIONS][20] = {  // Attribute an index to each of the 12 stations (0-11)
     "Amsterdam", "Den Haag", "Den Helder", "Utrecht", "Eindhoven", "Nijmegen",
     "Maastricht", "Enschede", "Zwolle", "Groningen", "Leeuwarden", "Meppel"};
+#endif
 
 // Node in adjacency list - represents a neighbour
 typedef struct Node {  // Add the word Node here so that I can use either the full struct Node
@@ -24,6 +41,7 @@ typedef struct {
 // Array of adjacency lists with is used throughout the code
 // - represents the graph (includes a neighbourhood - possibly empty - for each vertex)
 AdjacencyList graph[MAX_STATIONS];
+int adjacency_lists_loaded = 0;  // 1 while the lists above hold the graph
 
 // Node in min-heap - represents a station with its current best-known distance from the source
 typedef struct {
@@ -115,6 +133,159 @@ void remove_edge(const char* from, const char* to) {
   }
 }
 
+/*
+  Compressed adjacency (read-only copy of the graph that the searches run on):
+    compare_neighbours()
+    write_varint()
+    read_varint()
+    free_compressed_graph()
+    compress_graph()
+    load_adjacency_lists()
+*/
+
+// Compressed graph - every station's neighbours stored back to back (CSR) instead of one malloc'd Node per edge.
+// Station i owns edges [edge_start[i], edge_start[i + 1]) of travel_times and bytes
+// [byte_start[i], byte_start[i + 1]) of neighbours. The neighbours are sorted and each one is stored
+// as a varint of the gap to the previous one, so most neighbours take a single byte.
+typedef struct {
+  const int* edge_start;  // MAX_STATIONS + 1 entries
+  const int* byte_start;  // MAX_STATIONS + 1 entries
+  const unsigned char* neighbours;
+  const unsigned short* travel_times;  // 16 bits are enough for more than 45 days of travel
+  int allocated;                       // 1 if built by compress_graph(), 0 for the tables compiled in
+} CompressedGraph;
+
+#ifdef EMBEDDED_NETWORK
+CompressedGraph compressed = {embedded_edge_start, embedded_byte_start, embedded_neighbours,
+                              embedded_travel_times, 0};
+#else
+CompressedGraph compressed;
+#endif
+
+// Given two pointers to Nodes (inputs), returns their order by station index, for qsort() (output).
+int compare_neighbours(const void* a, const void* b) {
+  return ((const Node*)a)->station - ((const Node*)b)->station;
+}
+
+// Given a byte buffer and a non-negative value (inputs), stores the value 7 bits per byte, lowest bits first,
+// with the top bit set on every byte but the last, and returns the number of bytes written (output).
+int write_varint(unsigned char* bytes, int value) {
+  int count = 0;
+  while (value >= 0x80) {
+    bytes[count++] = (unsigned char)(value | 0x80);
+    value >>= 7;
+  }
+  bytes[count++] = (unsigned char)value;
+  return count;
+}
+
+// Given a pointer to a position in a byte buffer (input), decodes the varint there, moves
+// the position past it and returns the value (output).
+int read_varint(const unsigned char** bytes) {
+  const unsigned char* p = *bytes;
+  int value = *p & 0x7F;
+  int shift = 7;
+  while (*p++ & 0x80) {  // Top bit set -> another byte follows
+    value |= (*p & 0x7F) << shift;
+    shift += 7;
+  }
+  *bytes = p;
+  return value;
+}
+
+// Frees the compressed graph, if compress_graph() built one (no input and no output).
+void free_compressed_graph() {
+  if (!compressed.allocated)
+    return;  // Nothing built yet, or the read-only tables compiled into the binary
+  free((void*)compressed.edge_start);
+  free((void*)compressed.byte_start);
+  free((void*)compressed.neighbours);
+  free((void*)compressed.travel_times);
+  memset(&compressed, 0, sizeof(compressed));
+}
+
+// Builds the compressed graph from the adjacency lists (no input). Must be called again after
+// the lists change. Returns 1 on success, or 0 if a travel time is not between 1 and 65535 (output).
+// Zero-minute edges are refused: with them, equally short paths could point back at each other.
+// On failure the previous compressed graph is kept, so the searches can go on using it.
+int compress_graph() {
+  int num_edges = 0;
+  int max_degree = 0;
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    int degree = 0;
+    for (Node* current = graph[i].head; current; current = current->next) {
+      if (current->travel_time < 1 || current->travel_time > USHRT_MAX) {
+        fprintf(stderr, "Error: travel time %d must be between 1 and %d minutes.\n", current->travel_time, USHRT_MAX);
+        return 0;
+      }
+      degree++;
+    }
+    num_edges += degree;
+    if (degree > max_degree)
+      max_degree = degree;
+  }
+
+  int* edge_start = (int*)malloc((MAX_STATIONS + 1) * sizeof(int));
+  int* byte_start = (int*)malloc((MAX_STATIONS + 1) * sizeof(int));
+  // A varint of an int takes at most 5 bytes; the buffer is shrunk to its real size below
+  unsigned char* neighbours = (unsigned char*)malloc(5 * num_edges + 1);
+  unsigned short* travel_times = (unsigned short*)malloc((num_edges + 1) * sizeof(unsigned short));
+  Node* sorted = (Node*)malloc((max_degree + 1) * sizeof(Node));
+
+  int edge = 0;
+  int byte = 0;
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    edge_start[i] = edge;
+    byte_start[i] = byte;
+
+    int degree = 0;
+    for (Node* current = graph[i].head; current; current = current->next) {
+      sorted[degree++] = *current;
+    }
+    qsort(sorted, degree, sizeof(Node), compare_neighbours);
+
+    int last = 0;
+    for (int k = 0; k < degree; k++) {
+      byte += write_varint(neighbours + byte, sorted[k].station - last);
+      last = sorted[k].station;
+      travel_times[edge++] = (unsigned short)sorted[k].travel_time;
+    }
+  }
+  edge_start[MAX_STATIONS] = edge;
+  byte_start[MAX_STATIONS] = byte;
+
+  free_compressed_graph();  // Only now that the new one is complete
+  compressed.edge_start = edge_start;
+  compressed.byte_start = byte_start;
+  compressed.neighbours = (unsigned char*)realloc(neighbours, byte + 1);
+  compressed.travel_times = travel_times;
+  compressed.allocated = 1;
+
+  free(sorted);
+  return 1;
+}
+
+// Builds the adjacency lists from the compressed graph, so that it can be edited, unless
+// the lists already hold the graph (no input and no output). Used to apply disruptions to
+// the read-only tables of an EMBEDDED_NETWORK build.
+void load_adjacency_lists() {
+  if (adjacency_lists_loaded)
+    return;
+
+  for (int u = 0; u < MAX_STATIONS; u++) {
+    graph[u].head = NULL;
+    const unsigned char* bytes = compressed.neighbours + compressed.byte_start[u];
+    int v = 0;
+    for (int e = compressed.edge_start[u]; e < compressed.edge_start[u + 1]; e++) {
+      v += read_varint(&bytes);
+      Node* new_node = create_node(v, compressed.travel_times[e]);  // Each direction is stored,
+      new_node->next = graph[u].head;                               // so no add_edge() here
+      graph[u].head = new_node;
+    }
+  }
+  adjacency_lists_loaded = 1;
+}
+
 /*
   Helper functions for min-heap:
     create_min_heap()
@@ -122,6 +293,7 @@ void remove_edge(const char* from, const char* to) {
     downheap()
     remove_min()
     decrease_dist()
+    insert_station()
     is_in_min_heap()
 */
 
@@ -199,6 +371,15 @@ void decrease_dist(MinHeap* heap, int station, int distance) {
   }
 }
 
+// Given a pointer to a MinHeap, a station, and its distance (inputs), adds the station
+// at the end of the heap and bubbles it up to its place (no output).
+void insert_station(MinHeap* heap, int station, int distance) {
+  heap->array[heap->size].station = station;
+  heap->array[heap->size].distance = distance;
+  heap->position[station] = heap->size++;
+  decrease_dist(heap, station, distance);
+}
+
 // Given a pointer to a MinHeap and a station index (inputs),
 // returns 1 if the station is still in the heap, or 0 otherwise (output).
 int is_in_min_heap(MinHeap* heap, int station) {  // avoids linear search
@@ -206,15 +387,283 @@ int is_in_min_heap(MinHeap* heap, int station) {  // avoids linear search
 }
 
 /*
-  Dijkstra's algorithm
+  Parallel delta-stepping (same distances and paths as shortest_paths(), for big one-to-all searches)
+    pack_label()
+    label_distance()
+    label_previous()
+    push_int()
+    default_delta()
+    relax_phase()
+    delta_stepping_worker()
+    create_delta_stepping()
+    free_delta_stepping()
+    run_phase()
+    delta_stepping()
 */
 
-// Given start and goal station indices (inputs), runs Dijkstra's
-// shortest path algorithm and prints the path and distance (no output).
-void dijkstra(int start, int goal) {
-  int distances[MAX_STATIONS];
-  int previous[MAX_STATIONS];
+#define MAX_THREADS 64
+
+// Search options, set from the command line in main()
+int search_threads = 0;  // 0 -> sequential Dijkstra, otherwise delta-stepping on this many threads
+int search_delta = 0;    // delta-stepping bucket width, 0 -> default_delta()
+
+// Growable array of station indices - used for the buckets, the frontier and the per-thread results
+typedef struct {
+  int* items;
+  int size;
+  int capacity;
+} IntList;
+
+typedef struct DeltaStepping DeltaStepping;
+
+// Worker argument - a thread needs the shared state and its own number
+typedef struct {
+  DeltaStepping* ds;
+  int id;
+} DeltaSteppingThread;
+
+// Thread pool and shared state of the delta-stepping searches. The threads are started once by
+// create_delta_stepping() and wait at the barrier between searches. During a search, thread 0 (the
+// caller) does the bookkeeping between two barriers, all threads (including thread 0) relax their
+// share of the frontier in between. Only one search may use a pool at a time.
+struct DeltaStepping {
+  _Atomic unsigned long long label[MAX_STATIONS];  // (distance << 32) | previous, so that one
+                                                   // compare-and-swap updates both at once
+  int start;                                       // never relaxed, so it keeps previous = -1
+  int delta;                                       // bucket width, edges <= delta are "light"
+  int num_threads;
+  int heavy;                     // 0 -> relax the light edges of the frontier, 1 -> the heavy ones
+  int done;                      // set by thread 0 to tell the workers to exit
+  IntList frontier;              // stations whose edges are relaxed in the current phase
+  IntList improved[MAX_THREADS];  // stations whose distance each thread lowered in this phase
+  pthread_barrier_t barrier;
+  pthread_t threads[MAX_THREADS];
+  DeltaSteppingThread args[MAX_THREADS];
+};
+
+// Pool used by search() when --threads or --delta-stepping was given, NULL otherwise
+DeltaStepping* search_pool = NULL;
+
+// Given a distance and a previous station (inputs), returns the packed 64-bit label (output).
+// Comparing two labels compares the distances first and the previous stations second, so of two
+// equally short paths the one through the lowest-numbered previous station wins, like in shortest_paths().
+unsigned long long pack_label(int distance, int previous) {
+  return ((unsigned long long)(unsigned)distance << 32) | (unsigned)previous;
+}
+
+// Given a packed label (input), returns its distance (output).
+int label_distance(unsigned long long label) {
+  return (int)(label >> 32);
+}
+
+// Given a packed label (input), returns its previous station (output).
+int label_previous(unsigned long long label) {
+  return (int)(unsigned)(label & 0xFFFFFFFFu);
+}
+
+// Given a pointer to an IntList and a value (inputs), appends the value, growing the list if needed (no output).
+void push_int(IntList* list, int value) {
+  if (list->size == list->capacity) {
+    list->capacity = list->capacity ? 2 * list->capacity : 16;
+    list->items = (int*)realloc(list->items, list->capacity * sizeof(int));
+  }
+  list->items[list->size++] = value;
+}
+
+// Returns a bucket width for the current graph: the largest travel time divided by the
+// average number of neighbours, which keeps most edges light without making buckets huge (output).
+int default_delta() {
+  int max_time = 1;
+  int edges = compressed.edge_start[MAX_STATIONS];
+  for (int e = 0; e < edges; e++) {
+    if (compressed.travel_times[e] > max_time)
+      max_time = compressed.travel_times[e];
+  }
+  if (edges == 0)
+    return 1;
+  int delta = max_time * MAX_STATIONS / edges;
+  return delta > 0 ? delta : 1;
+}
+
+// Given the shared state and a thread number (inputs), relaxes the light or heavy edges of every
+// num_threads-th frontier station, starting at the thread's own number (no output).
+void relax_phase(DeltaStepping* ds, int id) {
+  for (int k = id; k < ds->frontier.size; k += ds->num_threads) {
+    int u = ds->frontier.items[k];
+    int du = label_distance(atomic_load(&ds->label[u]));
+
+    const unsigned char* bytes = compressed.neighbours + compressed.byte_start[u];
+    int v = 0;
+    for (int e = compressed.edge_start[u]; e < compressed.edge_start[u + 1]; e++) {
+      v += read_varint(&bytes);
+      int travel_time = compressed.travel_times[e];
+      if ((travel_time > ds->delta) != ds->heavy || v == ds->start)
+        continue;  // Not an edge of this phase, or back to the start
+
+      unsigned long long candidate = pack_label(du + travel_time, u);
+      unsigned long long old = atomic_load(&ds->label[v]);
+      while (candidate < old) {  // Atomic minimum, retried if another thread got there first
+        if (atomic_compare_exchange_weak(&ds->label[v], &old, candidate)) {
+          if (label_distance(candidate) < label_distance(old))
+            push_int(&ds->improved[id], v);  // Only a shorter distance changes the bucket
+          break;
+        }
+      }
+    }
+  }
+}
+
+// Given a DeltaSteppingThread (input), relaxes its share of every phase until thread 0 is done (output: NULL).
+void* delta_stepping_worker(void* arg) {
+  DeltaSteppingThread* thread = (DeltaSteppingThread*)arg;
+  DeltaStepping* ds = thread->ds;
+
+  while (1) {
+    pthread_barrier_wait(&ds->barrier);  // Wait for thread 0 to publish the frontier
+    if (ds->done)
+      break;
+    relax_phase(ds, thread->id);
+    pthread_barrier_wait(&ds->barrier);  // Tell thread 0 the phase is over
+  }
+  return NULL;
+}
+
+// Given a number of threads (input), returns a new pool with that many threads, the caller
+// counting as thread 0, ready for delta_stepping() (output).
+DeltaStepping* create_delta_stepping(int num_threads) {
+  DeltaStepping* ds = (DeltaStepping*)calloc(1, sizeof(DeltaStepping));
+  ds->num_threads = num_threads < 1 ? 1 : (num_threads > MAX_THREADS ? MAX_THREADS : num_threads);
+
+  pthread_barrier_init(&ds->barrier, NULL, ds->num_threads);
+  for (int t = 1; t < ds->num_threads; t++) {  // The caller is thread 0
+    ds->args[t].ds = ds;
+    ds->args[t].id = t;
+    pthread_create(&ds->threads[t], NULL, delta_stepping_worker, &ds->args[t]);
+  }
+  return ds;
+}
+
+// Given a pool (input), stops its threads and frees it (no output).
+void free_delta_stepping(DeltaStepping* ds) {
+  ds->done = 1;  // Release the workers from their first barrier
+  pthread_barrier_wait(&ds->barrier);
+  for (int t = 1; t < ds->num_threads; t++) {
+    pthread_join(ds->threads[t], NULL);
+  }
+
+  free(ds->frontier.items);
+  for (int t = 0; t < ds->num_threads; t++) {
+    free(ds->improved[t].items);
+  }
+  pthread_barrier_destroy(&ds->barrier);
+  free(ds);
+}
+
+// Given the shared state, the buckets and their count, and the kind of edges (inputs), relaxes the
+// frontier on all threads, then moves every improved station to its new bucket (no output).
+void run_phase(DeltaStepping* ds, IntList** buckets, int* num_buckets, int heavy) {
+  if (ds->frontier.size == 0)
+    return;
+
+  ds->heavy = heavy;
+  pthread_barrier_wait(&ds->barrier);
+  relax_phase(ds, 0);
+  pthread_barrier_wait(&ds->barrier);
+
+  for (int t = 0; t < ds->num_threads; t++) {
+    for (int k = 0; k < ds->improved[t].size; k++) {
+      int v = ds->improved[t].items[k];
+      int b = label_distance(atomic_load(&ds->label[v])) / ds->delta;
+
+      if (b >= *num_buckets) {  // Grow the bucket array so that bucket b exists
+        int new_count = 2 * b + 1;
+        *buckets = (IntList*)realloc(*buckets, new_count * sizeof(IntList));
+        memset(*buckets + *num_buckets, 0, (new_count - *num_buckets) * sizeof(IntList));
+        *num_buckets = new_count;
+      }
+      push_int(&(*buckets)[b], v);  // Duplicates and stale entries are skipped when the bucket is emptied
+    }
+    ds->improved[t].size = 0;
+  }
+}
+
+// Given a pool, a start station index, the bucket width (<= 0 picks default_delta()) and two arrays
+// of size MAX_STATIONS (inputs), runs delta-stepping on the pool's threads and fills in the same
+// distances and predecessors as shortest_paths() (no output). Both keep the lowest-numbered previous
+// station when two paths are equally short.
+void delta_stepping(DeltaStepping* ds, int start, int delta, int distances[], int previous[]) {
+  ds->start = start;
+  ds->delta = delta > 0 ? delta : default_delta();
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    atomic_store(&ds->label[i], pack_label(INF, -1));
+  }
+  atomic_store(&ds->label[start], pack_label(0, -1));
 
+  int num_buckets = 1;
+  IntList* buckets = (IntList*)calloc(num_buckets, sizeof(IntList));
+  push_int(&buckets[0], start);
+
+  IntList settled = {NULL, 0, 0};  // Stations taken out of the current bucket, for the heavy phase
+  int in_frontier[MAX_STATIONS];   // Round in which a station was last put in the frontier
+  int in_settled[MAX_STATIONS];    // Bucket (+1) in which a station was last settled
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    in_frontier[i] = 0;
+    in_settled[i] = 0;
+  }
+  int round = 0;
+
+  for (int i = 0; i < num_buckets; i++) {
+    settled.size = 0;
+    while (buckets[i].size > 0) {  // Light edges can put stations back in bucket i
+      round++;
+      ds->frontier.size = 0;
+      for (int k = 0; k < buckets[i].size; k++) {
+        int v = buckets[i].items[k];
+        if (label_distance(atomic_load(&ds->label[v])) / ds->delta != i || in_frontier[v] == round)
+          continue;  // Stale entry (station moved to a lower bucket) or duplicate
+        in_frontier[v] = round;
+        push_int(&ds->frontier, v);
+        if (in_settled[v] != i + 1) {
+          in_settled[v] = i + 1;
+          push_int(&settled, v);
+        }
+      }
+      buckets[i].size = 0;
+      run_phase(ds, &buckets, &num_buckets, 0);
+    }
+
+    ds->frontier.size = 0;  // Heavy edges always leave bucket i, so one pass is enough
+    for (int k = 0; k < settled.size; k++) {
+      push_int(&ds->frontier, settled.items[k]);
+    }
+    run_phase(ds, &buckets, &num_buckets, 1);
+  }
+
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    unsigned long long label = atomic_load(&ds->label[i]);
+    distances[i] = label_distance(label);
+    previous[i] = label_previous(label);
+  }
+
+  for (int i = 0; i < num_buckets; i++) {  // free memory
+    free(buckets[i].items);
+  }
+  free(buckets);
+  free(settled.items);
+}
+
+/*
+  Dijkstra's algorithm
+    shortest_paths()
+    print_path()
+    search()
+    dijkstra()
+*/
+
+// Given a start station index and two arrays of size MAX_STATIONS (inputs), runs Dijkstra's
+// shortest path algorithm and fills in the distance and predecessor of every station (no output).
+// Of two equally short paths, the one through the lowest-numbered previous station is kept.
+void shortest_paths(int start, int distances[], int previous[]) {
   for (int i = 0; i < MAX_STATIONS; i++) {  // Ensure proper initialization of distances and previous
     distances[i] = INF;
     previous[i] = -1;
@@ -235,19 +684,32 @@ void dijkstra(int start, int goal) {
     MinHeapNode minNode = remove_min(heap);
     int u = minNode.station;
 
-    Node* current = graph[u].head;
-    while (current) {
-      int v = current->station;
-      if (is_in_min_heap(heap, v) && distances[u] != INF &&
-          distances[u] + current->travel_time < distances[v]) {
-        distances[v] = distances[u] + current->travel_time;
+    const unsigned char* bytes = compressed.neighbours + compressed.byte_start[u];
+    int v = 0;
+    for (int e = compressed.edge_start[u]; e < compressed.edge_start[u + 1]; e++) {
+      v += read_varint(&bytes);  // Neighbours are stored as gaps from the previous one
+      int travel_time = compressed.travel_times[e];
+      if (!is_in_min_heap(heap, v) || distances[u] == INF)
+        continue;
+
+      if (distances[u] + travel_time < distances[v]) {
+        distances[v] = distances[u] + travel_time;
         previous[v] = u;
         decrease_dist(heap, v, distances[v]);
+      } else if (distances[u] + travel_time == distances[v] && u < previous[v]) {
+        previous[v] = u;  // Equally short: same tie rule as delta_stepping(), whatever the heap order
       }
-      current = current->next;
     }
   }
 
+  free(heap->array);     // free memory
+  free(heap->position);  // it seemed too simple and obvious to add a helper functions (there are so many already)
+  free(heap);
+}
+
+// Given a goal station index and the arrays filled in by a shortest path search (inputs),
+// prints the path and distance, or UNREACHABLE (no output).
+void print_path(int goal, const int distances[], const int previous[]) {
   if (distances[goal] == INF) {  // Print the result
     printf("UNREACHABLE\n");
   } else {
@@ -264,18 +726,184 @@ void dijkstra(int start, int goal) {
     }
     printf("%d\n", distances[goal]);
   }
+}
 
-  free(heap->array);     // free memory
-  free(heap->position);  // it seemed too simple and obvious to add a helper functions (there are so many already)
-  free(heap);
+// Given a start station index and two arrays of size MAX_STATIONS (inputs), fills them in with
+// shortest_paths(), or with delta_stepping() when --threads or --delta-stepping was given (no output).
+// A build with an embedded all-pairs table copies the answer from it while there are no disruptions.
+void search(int start, int distances[], int previous[]) {
+#ifdef EMBEDDED_ALL_PAIRS
+  if (!compressed.allocated) {  // Still the embedded graph
+    memcpy(distances, embedded_distances[start], MAX_STATIONS * sizeof(int));
+    memcpy(previous, embedded_previous[start], MAX_STATIONS * sizeof(int));
+    return;
+  }
+#endif
+  if (search_pool)
+    delta_stepping(search_pool, start, search_delta, distances, previous);
+  else
+    shortest_paths(start, distances, previous);
+}
+
+// Given start and goal station indices (inputs), runs Dijkstra's
+// shortest path algorithm and prints the path and distance (no output).
+void dijkstra(int start, int goal) {
+  int distances[MAX_STATIONS];
+  int previous[MAX_STATIONS];
+
+  search(start, distances, previous);
+  print_path(goal, distances, previous);
+}
+
+/*
+  Isochrones (all stations reachable from a source within a time budget):
+    create_workspace()
+    free_workspace()
+    isochrone()
+    print_isochrone()
+*/
+
+// Search workspace - the heap and arrays of a bounded search. It is allocated once and reused for
+// every source, and only the stations touched by the previous search are reset.
+typedef struct {
+  MinHeap* heap;
+  int distances[MAX_STATIONS];  // INF for stations the search has not reached
+  int settled[MAX_STATIONS];    // 1 once a station's distance is final
+  int touched[MAX_STATIONS];    // stations whose distance was set, to reset them cheaply
+  int num_touched;
+  int reached[MAX_STATIONS];    // settled stations within the budget, in order of travel time
+  int num_reached;
+} SearchWorkspace;
+
+// Returns a pointer to a newly allocated, empty SearchWorkspace (output).
+SearchWorkspace* create_workspace() {
+  SearchWorkspace* ws = (SearchWorkspace*)malloc(sizeof(SearchWorkspace));
+  ws->heap = create_min_heap(MAX_STATIONS);
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    ws->distances[i] = INF;
+    ws->settled[i] = 0;
+  }
+  ws->num_touched = 0;
+  ws->num_reached = 0;
+  return ws;
+}
+
+// Given a pointer to a SearchWorkspace (input), frees it (no output).
+void free_workspace(SearchWorkspace* ws) {
+  free(ws->heap->array);
+  free(ws->heap->position);
+  free(ws->heap);
+  free(ws);
+}
+
+// Given a workspace, a start station index and a time budget (inputs), runs Dijkstra's algorithm
+// from the start only until the closest unsettled station is further than the budget, and
+// leaves the reachable stations in ws->reached and their travel times in ws->distances (no output).
+void isochrone(SearchWorkspace* ws, int start, int budget) {
+  for (int i = 0; i < ws->num_touched; i++) {  // Undo the previous search
+    ws->distances[ws->touched[i]] = INF;
+    ws->settled[ws->touched[i]] = 0;
+  }
+  ws->num_touched = 0;
+  ws->num_reached = 0;
+  ws->heap->size = 0;
+
+  // Unlike shortest_paths(), stations only enter the heap once they are reached,
+  // so a small budget never looks at the rest of the network
+  ws->distances[start] = 0;
+  ws->touched[ws->num_touched++] = start;
+  insert_station(ws->heap, start, 0);
+
+  while (ws->heap->size > 0 && ws->heap->array[0].distance <= budget) {
+    int u = remove_min(ws->heap).station;
+    ws->settled[u] = 1;
+    ws->reached[ws->num_reached++] = u;
+
+    const unsigned char* bytes = compressed.neighbours + compressed.byte_start[u];
+    int v = 0;
+    for (int e = compressed.edge_start[u]; e < compressed.edge_start[u + 1]; e++) {
+      v += read_varint(&bytes);
+      int distance = ws->distances[u] + compressed.travel_times[e];
+      if (ws->settled[v] || distance >= ws->distances[v])
+        continue;
+
+      if (ws->distances[v] == INF) {  // First time v is reached
+        ws->touched[ws->num_touched++] = v;
+        ws->distances[v] = distance;
+        insert_station(ws->heap, v, distance);
+      } else {
+        ws->distances[v] = distance;
+        decrease_dist(ws->heap, v, distance);
+      }
+    }
+  }
+}
+
+// Given a workspace filled in by isochrone() (input), prints every reachable
+// station and its travel time, closest first (no output).
+void print_isochrone(const SearchWorkspace* ws) {
+  for (int i = 0; i < ws->num_reached; i++) {
+    int station = ws->reached[i];
+    printf("%s %d\n", station_names[station], ws->distances[station]);
+  }
 }
 
 /*
   Helper functions for graph representation
+    track_checksum()
+    builtin_checksum()
     initialize_graph()
+    read_network()
     free_graph()
 */
 
+// Track - a bidirectional connection between two stations and its travel time in minutes
+typedef struct {
+  const char* from;
+  const char* to;
+  int travel_time;
+} Track;
+
+// The predefined network built by initialize_graph()
+const Track builtin_tracks[] = {
+    {"Amsterdam", "Den Haag", 46},
+    {"Amsterdam", "Den Helder", 77},
+    {"Amsterdam", "Utrecht", 26},
+    {"Den Haag", "Eindhoven", 89},
+    {"Eindhoven", "Maastricht", 63},
+    {"Eindhoven", "Nijmegen", 55},
+    {"Eindhoven", "Utrecht", 47},
+    {"Enschede", "Zwolle", 50},
+    {"Groningen", "Leeuwarden", 34},
+    {"Groningen", "Meppel", 49},
+    {"Leeuwarden", "Meppel", 40},
+    {"Maastricht", "Nijmegen", 111},
+    {"Meppel", "Zwolle", 15},
+    {"Nijmegen", "Zwolle", 77},
+    {"Utrecht", "Zwolle", 51}};
+
+#define NUM_BUILTIN_TRACKS ((int)(sizeof(builtin_tracks) / sizeof(builtin_tracks[0])))
+
+// Given a checksum so far and a track (inputs), returns the checksum with the track added (output).
+// FNV-1a over the two names and the travel time, so any edit of a network description changes it.
+unsigned int track_checksum(unsigned int hash, const char* from, const char* to, int travel_time) {
+  char text[128];
+  int length = snprintf(text, sizeof(text), "%s\n%s\n%d\n", from, to, travel_time);
+  for (int i = 0; i < length && i < (int)sizeof(text) - 1; i++) {
+    hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+  }
+  return hash;
+}
+
+// Returns the checksum of the built-in network (output). Needs no graph, so it is cheap at startup.
+unsigned int builtin_checksum() {
+  unsigned int hash = 2166136261u;
+  for (int i = 0; i < NUM_BUILTIN_TRACKS; i++) {
+    hash = track_checksum(hash, builtin_tracks[i].from, builtin_tracks[i].to, builtin_tracks[i].travel_time);
+  }
+  return hash;
+}
+
 // Builds the initial graph by setting all
 // adjacency list heads to NULL, then adding predefined edges. (no input and no output)
 void initialize_graph() {
@@ -283,21 +911,44 @@ void initialize_graph() {
     graph[i].head = NULL;
   }
 
-  add_edge("Amsterdam", "Den Haag", 46);
-  add_edge("Amsterdam", "Den Helder", 77);
-  add_edge("Amsterdam", "Utrecht", 26);
-  add_edge("Den Haag", "Eindhoven", 89);
-  add_edge("Eindhoven", "Maastricht", 63);
-  add_edge("Eindhoven", "Nijmegen", 55);
-  add_edge("Eindhoven", "Utrecht", 47);
-  add_edge("Enschede", "Zwolle", 50);
-  add_edge("Groningen", "Leeuwarden", 34);
-  add_edge("Groningen", "Meppel", 49);
-  add_edge("Leeuwarden", "Meppel", 40);
-  add_edge("Maastricht", "Nijmegen", 111);
-  add_edge("Meppel", "Zwolle", 15);
-  add_edge("Nijmegen", "Zwolle", 77);
-  add_edge("Utrecht", "Zwolle", 51);
+  for (int i = 0; i < NUM_BUILTIN_TRACKS; i++) {
+    add_edge(builtin_tracks[i].from, builtin_tracks[i].to, builtin_tracks[i].travel_time);
+  }
+  adjacency_lists_loaded = 1;
+}
+
+// Given an open network description and a pointer for its checksum (inputs), builds the graph
+// from it instead of the predefined edges. The description uses the format of the disruptions:
+// the number of tracks, then for each track two station names and a travel time, one per line.
+// Returns 1 on success, or 0 if the description is invalid (output).
+int read_network(FILE* in, unsigned int* checksum) {
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    graph[i].head = NULL;
+  }
+  adjacency_lists_loaded = 1;  // Even when failing, so that free_graph() cleans up
+  *checksum = 2166136261u;
+
+  int num_tracks;
+  if (fscanf(in, "%d", &num_tracks) != 1) {
+    fprintf(stderr, "Error: network description must start with the number of tracks.\n");
+    return 0;
+  }
+  for (int i = 0; i < num_tracks; i++) {
+    char from[50], to[50];
+    int travel_time;
+    if (fscanf(in, " %49[^\n]", from) != 1 || fscanf(in, " %49[^\n]", to) != 1 ||
+        fscanf(in, "%d", &travel_time) != 1) {
+      fprintf(stderr, "Error: network description ends after %d of %d tracks.\n", i, num_tracks);
+      return 0;
+    }
+    if (get_station_index(from) == -1 || get_station_index(to) == -1) {
+      fprintf(stderr, "Error: track %d: one or both stations are invalid.\n", i + 1);
+      return 0;
+    }
+    add_edge(from, to, travel_time);
+    *checksum = track_checksum(*checksum, from, to, travel_time);
+  }
+  return 1;
 }
 
 // Frees all dynamically allocated nodes, preventing memory leaks. (no input and no output)
@@ -311,10 +962,733 @@ void free_graph() {
     }
     graph[i].head = NULL;
   }
+  adjacency_lists_loaded = 0;
+}
+
+/*
+  Embedded network tables (--emit-tables): write the graph as C source for an EMBEDDED_NETWORK build
+    print_int_table()
+    emit_tables()
+*/
+
+// Given a C declaration, an array of values, its length, the number of values per line and whether
+// each line is a row of a 2D array (inputs), prints the array definition, with INF written as INF (no output).
+void print_int_table(const char* declaration, const int values[], int count, int per_line, int rows) {
+  printf("%s = {", declaration);
+  for (int i = 0; i < count; i++) {
+    if (i % per_line == 0)
+      printf("\n    %s", rows ? "{" : "");
+    if (values[i] == INF)
+      printf("INF");
+    else
+      printf("%d", values[i]);
+
+    int end_of_line = (i + 1) % per_line == 0 || i + 1 == count;
+    if (rows && end_of_line)
+      printf("}");
+    printf(i + 1 == count ? "" : (end_of_line ? "," : ", "));
+  }
+  printf("};\n\n");
+}
+
+// Given whether to include the all-pairs table, the network description file (NULL for the built-in
+// network) and its checksum (inputs), prints a header with the station names, the compressed graph
+// and optionally every shortest path, for compiling into the binary with -DEMBEDDED_NETWORK.
+// Must be run after compress_graph() (no output).
+void emit_tables(int all_pairs, const char* network, unsigned int checksum) {
+  int num_edges = compressed.edge_start[MAX_STATIONS];
+  int num_bytes = compressed.byte_start[MAX_STATIONS];
+  int values[MAX_STATIONS * MAX_STATIONS];
+
+  printf("// Generated by `trains --emit-tables%s%s%s` from %s. Do not edit.\n", all_pairs ? " --all-pairs" : "",
+         network ? " --network " : "", network ? network : "", network ? "a network description" : "initialize_graph()");
+  printf("// Included by trains.c when it is compiled with -DEMBEDDED_NETWORK.\n\n");
+  printf("#if MAX_STATIONS != %d\n#error \"trainsNetwork.h was generated for a different MAX_STATIONS\"\n#endif\n\n", MAX_STATIONS);
+
+  // Checksum of the tracks the tables come from. For the built-in network, main() compares it with
+  // builtin_checksum() at startup; for a description, --check-tables FILE compares it with the file.
+  printf("#define EMBEDDED_CHECKSUM 0x%08xu\n", checksum);
+  if (!network)
+    printf("#define EMBEDDED_FROM_BUILTIN\n");
+  if (all_pairs)
+    printf("#define EMBEDDED_ALL_PAIRS\n");
+  printf("\n");
+
+  printf("const char station_names[MAX_STATIONS][20] = {");
+  for (int i = 0; i < MAX_STATIONS; i++) {
+    printf("%s\n    \"%s\"", i ? "," : "", station_names[i]);
+  }
+  printf("};\n\n");
+
+  print_int_table("static const int embedded_edge_start[MAX_STATIONS + 1]", compressed.edge_start, MAX_STATIONS + 1, 12, 0);
+  print_int_table("static const int embedded_byte_start[MAX_STATIONS + 1]", compressed.byte_start, MAX_STATIONS + 1, 12, 0);
+
+  for (int i = 0; i < num_bytes; i++) {
+    values[i] = compressed.neighbours[i];
+  }
+  print_int_table("static const unsigned char embedded_neighbours[]", values, num_bytes, 12, 0);
+  for (int i = 0; i < num_edges; i++) {
+    values[i] = compressed.travel_times[i];
+  }
+  print_int_table("static const unsigned short embedded_travel_times[]", values, num_edges, 12, 0);
+
+  if (all_pairs) {  // Row s holds the answer of shortest_paths(s, ...)
+    int previous[MAX_STATIONS * MAX_STATIONS];
+    for (int s = 0; s < MAX_STATIONS; s++) {
+      shortest_paths(s, values + s * MAX_STATIONS, previous + s * MAX_STATIONS);
+    }
+    print_int_table("static const int embedded_distances[MAX_STATIONS][MAX_STATIONS]", values, MAX_STATIONS * MAX_STATIONS, MAX_STATIONS, 1);
+    print_int_table("static const int embedded_previous[MAX_STATIONS][MAX_STATIONS]", previous, MAX_STATIONS * MAX_STATIONS, MAX_STATIONS, 1);
+  }
+}
+
+/*
+  Router daemon (--serve PATH): keeps the graph in memory and answers pipelined
+  requests from any number of local clients over a Unix domain socket
+    release_connection()
+    enqueue_request()
+    wake_event_loop()
+    finish_request()
+    answer_request()
+    apply_disruption()
+    server_worker()
+    close_connection()
+    release_closed_connections()
+    flush_output()
+    service_connection()
+    handle_stop_signal()
+    serve()
+*/
+
+#define OP_ROUTE 1      // shortest route from 'from' to 'to'
+#define OP_ISOCHRONE 2  // stations reachable from 'from' within 'budget' minutes
+#define OP_DISRUPT 3    // remove the connection between 'from' and 'to'
+
+#define STATUS_OK 0
+#define STATUS_UNREACHABLE 1
+#define STATUS_BAD_REQUEST 2
+
+#define MAX_EVENTS 64
+#define MAX_PENDING 1024           // unanswered requests per client before its socket stops being read
+#define MAX_OUTPUT (256 * 1024)    // unsent response bytes per client before its socket stops being read
+
+// Request - fixed 12 bytes in the byte order of the machine (client and server are on the same host).
+// Clients may send many requests without waiting for the answers; every response carries the id
+// of its request, because routes and isochrones are answered by several workers at once.
+typedef struct {
+  unsigned int id;
+  unsigned char op;
+  unsigned char reserved;
+  unsigned short from;    // station index (0-11)
+  unsigned short to;      // station index, for OP_ROUTE and OP_DISRUPT
+  unsigned short budget;  // minutes, for OP_ISOCHRONE
+} Request;
+
+// Response header - followed by 'count' station indices (unsigned short): the route from start to
+// goal for OP_ROUTE, the reachable stations for OP_ISOCHRONE. For OP_ISOCHRONE 'count' travel
+// times (int) follow, in the same order.
+typedef struct {
+  unsigned int id;
+  unsigned char op;
+  unsigned char status;
+  unsigned short count;
+  int distance;  // total travel time for OP_ROUTE, -1 otherwise
+} ResponseHeader;
+
+_Static_assert(sizeof(Request) == 12 && sizeof(ResponseHeader) == 12, "protocol frames must not have padding");
+
+#define MAX_RESPONSE (sizeof(ResponseHeader) + MAX_STATIONS * (sizeof(unsigned short) + sizeof(int)))
+
+// Client connection. Only the event loop touches the socket; workers append their answers to
+// 'output' and ask the loop to send them, so a client that does not read cannot block anyone else.
+typedef struct Connection {
+  int fd;                      // non-blocking
+  unsigned int events;         // epoll interest currently registered (event loop only)
+  unsigned char input[MAX_EVENTS * sizeof(Request)];  // bytes of requests not handed out yet (event loop only)
+  int used;
+  struct Connection* prev;     // list of open connections, then of connections closed in the
+  struct Connection* next;     // current batch of events (event loop only)
+
+  // Guarded by jobs.lock
+  int refs;                    // the event loop + one per unanswered request + one while on the ready list
+  int closed;                  // socket closed, answers still being computed are dropped
+  int read_closed;             // client sent EOF: answer what is pending, then close
+  int pending;                 // requests handed to the workers and not answered yet
+  unsigned char* output;       // answers not sent yet
+  int output_size;
+  int output_capacity;
+  int on_ready_list;
+  struct Connection* ready_next;
+} Connection;
+
+// Request waiting for a worker
+typedef struct {
+  Connection* conn;
+  Request request;
+} Job;
+
+// Queue of requests shared between the event loop and the workers (ring buffer, grows when full),
+// and the list of connections the workers have answered on since the event loop last looked
+typedef struct {
+  Job* items;
+  int head;
+  int count;
+  int capacity;
+  int running;    // jobs taken by a worker and not answered yet
+  int exclusive;  // 1 while a disruption changes the graph, no other job may start
+  int stopping;   // set when the server shuts down
+  Connection* ready;
+  pthread_mutex_t lock;
+  pthread_cond_t job_ready;
+} JobQueue;
+
+JobQueue jobs = {NULL, 0, 0, 0, 0, 0, 0, NULL, PTHREAD_MUTEX_INITIALIZER, PTHREAD_COND_INITIALIZER};
+
+// Connections owned by the event loop
+typedef struct {
+  int epoll_fd;
+  Connection* open;    // connections being served
+  Connection* closed;  // closed during the current batch of events. Their last reference is only
+                       // dropped after the batch, since later events of the batch may point at them.
+} EventLoop;
+
+int wake_fd = -1;  // eventfd the workers write to when the ready list has something for the event loop
+
+volatile sig_atomic_t stop_requested = 0;
+
+// Given a connection (input), drops one reference to it and frees it after the last one.
+// Must be called with jobs.lock held (no output).
+void release_connection(Connection* conn) {
+  if (--conn->refs > 0)
+    return;
+  free(conn->output);
+  free(conn);
+}
+
+// Given a connection and a request (inputs), hands the request to the workers.
+// Must be called with jobs.lock held (no output).
+void enqueue_request(Connection* conn, const Request* request) {
+  if (jobs.count == jobs.capacity) {  // Grow the ring, unwrapping it into the new array
+    int new_capacity = jobs.capacity ? 2 * jobs.capacity : 256;
+    Job* items = (Job*)malloc(new_capacity * sizeof(Job));
+    for (int i = 0; i < jobs.count; i++) {
+      items[i] = jobs.items[(jobs.head + i) % jobs.capacity];
+    }
+    free(jobs.items);
+    jobs.items = items;
+    jobs.head = 0;
+    jobs.capacity = new_capacity;
+  }
+  Job* job = &jobs.items[(jobs.head + jobs.count++) % jobs.capacity];
+  job->conn = conn;
+  job->request = *request;
+  conn->refs++;
+  conn->pending++;
+  pthread_cond_signal(&jobs.job_ready);
+}
+
+// Wakes the event loop so that it looks at the ready list (no input and no output).
+void wake_event_loop() {
+  unsigned long long one = 1;
+  ssize_t written = write(wake_fd, &one, sizeof(one));  // Only fails if the counter is huge, which still wakes it
+  (void)written;
+}
+
+// Given a connection and a response (inputs), queues the response for sending, unless the
+// connection is closed, and puts the connection on the ready list. Must be called with
+// jobs.lock held (no output).
+void finish_request(Connection* conn, const unsigned char* response, int length) {
+  conn->pending--;
+  if (!conn->closed) {
+    if (conn->output_size + length > conn->output_capacity) {
+      conn->output_capacity = 2 * (conn->output_size + length);
+      conn->output = (unsigned char*)realloc(conn->output, conn->output_capacity);
+    }
+    memcpy(conn->output + conn->output_size, response, length);
+    conn->output_size += length;
+
+    if (!conn->on_ready_list) {  // The event loop sends it, and may read again now that pending dropped
+      conn->on_ready_list = 1;
+      conn->refs++;
+      conn->ready_next = jobs.ready;
+      jobs.ready = conn;
+    }
+  }
+  release_connection(conn);
+}
+
+// Given an OP_ROUTE or OP_ISOCHRONE request, the worker's workspace and a buffer of MAX_RESPONSE
+// bytes (inputs), runs the search, writes the response into the buffer and returns its length (output).
+int answer_request(const Request* request, SearchWorkspace* ws, unsigned char* response) {
+  ResponseHeader header = {request->id, request->op, STATUS_OK, 0, -1};
+  unsigned short stations[MAX_STATIONS];
+  int times[MAX_STATIONS];
+
+  if (request->from >= MAX_STATIONS ||
+      (request->op == OP_ROUTE && request->to >= MAX_STATIONS) ||
+      (request->op != OP_ROUTE && request->op != OP_ISOCHRONE)) {
+    header.status = STATUS_BAD_REQUEST;
+  } else if (request->op == OP_ROUTE) {
+    int distances[MAX_STATIONS];
+    int previous[MAX_STATIONS];
+    search(request->from, distances, previous);
+
+    if (distances[request->to] == INF) {
+      header.status = STATUS_UNREACHABLE;
+    } else {
+      header.distance = distances[request->to];
+      for (int v = request->to; v != -1; v = previous[v]) {  // Count the stations on the path
+        header.count++;
+      }
+      int index = header.count;
+      for (int v = request->to; v != -1; v = previous[v]) {  // and store them start first
+        stations[--index] = (unsigned short)v;
+      }
+    }
+  } else {
+    isochrone(ws, request->from, request->budget);
+    header.count = (unsigned short)ws->num_reached;
+    for (int i = 0; i < ws->num_reached; i++) {
+      stations[i] = (unsigned short)ws->reached[i];
+      times[i] = ws->distances[ws->reached[i]];
+    }
+  }
+
+  int length = 0;
+  memcpy(response, &header, sizeof(header));
+  length += sizeof(header);
+  memcpy(response + length, stations, header.count * sizeof(unsigned short));
+  length += header.count * sizeof(unsigned short);
+  if (request->op == OP_ISOCHRONE) {
+    memcpy(response + length, times, header.count * sizeof(int));
+    length += header.count * sizeof(int);
+  }
+  return length;
+}
+
+// Given an OP_DISRUPT request and a buffer of MAX_RESPONSE bytes (inputs), removes the connection
+// between the two stations, rebuilds the compressed graph, writes the response into the buffer and
+// returns its length (output). The caller makes sure that no other job runs meanwhile.
+int apply_disruption(const Request* request, unsigned char* response) {
+  ResponseHeader header = {request->id, request->op, STATUS_OK, 0, -1};
+
+  if (request->from >= MAX_STATIONS || request->to >= MAX_STATIONS) {
+    header.status = STATUS_BAD_REQUEST;
+  } else {
+    load_adjacency_lists();
+    remove_edge(station_names[request->from], station_names[request->to]);
+    if (!compress_graph())
+      header.status = STATUS_BAD_REQUEST;
+    free_graph();  // The compressed graph, old or new, is all the searches use
+  }
+
+  memcpy(response, &header, sizeof(header));
+  return sizeof(header);
+}
+
+// Takes requests from the queue and answers them until the server stops (output: NULL).
+// A disruption waits for the requests received before it to finish and runs alone, so every
+// request sees exactly the disruptions received before it.
+void* server_worker(void* arg) {
+  (void)arg;
+  SearchWorkspace* ws = create_workspace();  // One per worker, reused for all its isochrones
+  unsigned char response[MAX_RESPONSE];
+
+  pthread_mutex_lock(&jobs.lock);
+  while (1) {
+    while (!jobs.stopping && (jobs.count == 0 || jobs.exclusive ||
+                              (jobs.items[jobs.head].request.op == OP_DISRUPT && jobs.running > 0))) {
+      pthread_cond_wait(&jobs.job_ready, &jobs.lock);
+    }
+    if (jobs.stopping)
+      break;
+
+    Job job = jobs.items[jobs.head];
+    jobs.head = (jobs.head + 1) % jobs.capacity;
+    jobs.count--;
+    jobs.running++;
+    int disruption = job.request.op == OP_DISRUPT;
+    jobs.exclusive = disruption;
+    pthread_mutex_unlock(&jobs.lock);
+
+    int length = disruption ? apply_disruption(&job.request, response) : answer_request(&job.request, ws, response);
+
+    pthread_mutex_lock(&jobs.lock);
+    jobs.running--;
+    jobs.exclusive = 0;
+    finish_request(job.conn, response, length);
+    if (disruption || jobs.running == 0)  // Wake the workers waiting for a disruption or behind one
+      pthread_cond_broadcast(&jobs.job_ready);
+    wake_event_loop();
+  }
+  pthread_mutex_unlock(&jobs.lock);
+
+  free_workspace(ws);
+  return NULL;
+}
+
+// Given the event loop and a connection (inputs), closes the socket and moves the connection to
+// loop->closed, where release_closed_connections() drops the loop's reference later.
+// Must be called with jobs.lock held (no output).
+void close_connection(EventLoop* loop, Connection* conn) {
+  epoll_ctl(loop->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+  close(conn->fd);
+  conn->closed = 1;
+  if (conn->prev)
+    conn->prev->next = conn->next;
+  else
+    loop->open = conn->next;
+  if (conn->next)
+    conn->next->prev = conn->prev;
+
+  conn->prev = NULL;
+  conn->next = loop->closed;
+  loop->closed = conn;
 }
 
-int main() {
+// Given the event loop (input), drops its reference to every connection closed since the last call.
+// Must be called with jobs.lock held, between two batches of events (no output).
+void release_closed_connections(EventLoop* loop) {
+  while (loop->closed) {
+    Connection* next = loop->closed->next;
+    release_connection(loop->closed);
+    loop->closed = next;
+  }
+}
+
+// Given a connection (input), sends as much of its output as the socket takes without blocking.
+// Returns 1 if the connection is still usable, or 0 if the client has gone away (output).
+// Must be called with jobs.lock held.
+int flush_output(Connection* conn) {
+  int sent_total = 0;
+  while (sent_total < conn->output_size) {
+    ssize_t sent = send(conn->fd, conn->output + sent_total, conn->output_size - sent_total, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR)
+      continue;
+    if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      break;  // Socket full: EPOLLOUT will tell us when to go on
+    if (sent <= 0)
+      return 0;
+    sent_total += sent;
+  }
+  if (sent_total > 0) {
+    memmove(conn->output, conn->output + sent_total, conn->output_size - sent_total);
+    conn->output_size -= sent_total;
+  }
+  return 1;
+}
+
+// Given the event loop and a connection (inputs), hands out the
+// buffered requests the client may still have answered, sends what it can and decides whether to
+// read (below MAX_PENDING and MAX_OUTPUT) or write more, or to close. Must be called with jobs.lock held (no output).
+void service_connection(EventLoop* loop, Connection* conn) {
+  if (conn->closed)
+    return;
+
+  int offset = 0;  // Hand out every complete request the client may have, keep the rest for later
+  while (conn->used - offset >= (int)sizeof(Request) && conn->pending < MAX_PENDING) {
+    Request request;
+    memcpy(&request, conn->input + offset, sizeof(request));
+    offset += sizeof(request);
+    enqueue_request(conn, &request);
+  }
+  memmove(conn->input, conn->input + offset, conn->used - offset);
+  conn->used -= offset;
+
+  if (!flush_output(conn) ||
+      (conn->read_closed && conn->pending == 0 && conn->output_size == 0 && conn->used < (int)sizeof(Request))) {
+    close_connection(loop, conn);
+    return;
+  }
+
+  unsigned int events = 0;
+  if (!conn->read_closed && conn->pending < MAX_PENDING && conn->output_size < MAX_OUTPUT &&
+      conn->used < (int)sizeof(conn->input))
+    events |= EPOLLIN;
+  if (conn->output_size > 0)
+    events |= EPOLLOUT;
+  if (events != conn->events) {
+    struct epoll_event event;
+    event.events = events;
+    event.data.ptr = conn;
+    epoll_ctl(loop->epoll_fd, EPOLL_CTL_MOD, conn->fd, &event);
+    conn->events = events;
+  }
+}
+
+// Given a signal number (input), asks the event loop to stop (no output).
+void handle_stop_signal(int signal_number) {
+  (void)signal_number;
+  stop_requested = 1;
+}
+
+// Given a socket path and a number of worker threads (inputs), builds the graph once and answers
+// requests on the socket until SIGINT or SIGTERM. Returns 0 on a clean stop, 1 on error (output).
+int serve(const char* path, int num_workers) {
+  struct sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    printf("Error: socket path '%s' is too long.\n", path);
+    return 1;
+  }
+  strcpy(address.sun_path, path);
+
+  struct stat info;
+  if (lstat(path, &info) == 0) {  // Only ever remove a socket left by a previous run
+    if (!S_ISSOCK(info.st_mode)) {
+      printf("Error: '%s' already exists and is not a socket.\n", path);
+      return 1;
+    }
+    unlink(path);
+  }
+
+  int listen_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listen_fd < 0) {
+    perror("Error: cannot create socket");
+    return 1;
+  }
+  if (bind(listen_fd, (struct sockaddr*)&address, sizeof(address)) < 0 || listen(listen_fd, SOMAXCONN) < 0) {
+    perror("Error: cannot listen on socket");
+    close(listen_fd);
+    return 1;
+  }
+
+  EventLoop loop = {epoll_create1(EPOLL_CLOEXEC), NULL, NULL};
+  wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  struct epoll_event event;
+  event.events = EPOLLIN;
+  event.data.ptr = NULL;  // NULL marks the listening socket
+  epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, listen_fd, &event);
+  event.data.ptr = &wake_fd;  // &wake_fd marks the eventfd, every other event points at a Connection
+  epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, wake_fd, &event);
+
+  struct sigaction action;  // No SA_RESTART, so that epoll_wait() returns when a signal arrives
+  memset(&action, 0, sizeof(action));
+  action.sa_handler = handle_stop_signal;
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+
+#ifndef EMBEDDED_NETWORK
   initialize_graph();
+  int compressed_ok = compress_graph();
+  free_graph();  // Disruptions rebuild the lists from the compressed graph when they need them
+  if (!compressed_ok)
+    return 1;
+#endif
+
+  if (num_workers < 1)
+    num_workers = 1;
+  pthread_t* workers = (pthread_t*)malloc(num_workers * sizeof(pthread_t));
+  for (int i = 0; i < num_workers; i++) {
+    pthread_create(&workers[i], NULL, server_worker, NULL);
+  }
+
+  struct epoll_event events[MAX_EVENTS];
+  while (!stop_requested) {
+    int num_events = epoll_wait(loop.epoll_fd, events, MAX_EVENTS, -1);
+    if (num_events < 0 && errno != EINTR) {
+      perror("Error: epoll_wait");
+      break;
+    }
+
+    for (int i = 0; i < num_events; i++) {
+      Connection* conn = (Connection*)events[i].data.ptr;
+
+      if (!conn) {  // New clients
+        int fd;
+        while ((fd = accept4(listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+          conn = (Connection*)calloc(1, sizeof(Connection));
+          conn->fd = fd;
+          conn->refs = 1;
+          conn->events = EPOLLIN;
+          conn->next = loop.open;
+          if (loop.open)
+            loop.open->prev = conn;
+          loop.open = conn;
+
+          event.events = EPOLLIN;
+          event.data.ptr = conn;
+          epoll_ctl(loop.epoll_fd, EPOLL_CTL_ADD, fd, &event);
+        }
+        continue;
+      }
+
+      if ((void*)conn == (void*)&wake_fd) {  // Workers answered: send, and read again where pending dropped
+        unsigned long long count;
+        ssize_t got = read(wake_fd, &count, sizeof(count));
+        (void)got;
+        pthread_mutex_lock(&jobs.lock);
+        Connection* ready = jobs.ready;
+        jobs.ready = NULL;
+        while (ready) {
+          Connection* next = ready->ready_next;
+          ready->on_ready_list = 0;
+          service_connection(&loop, ready);
+          release_connection(ready);
+          ready = next;
+        }
+        pthread_mutex_unlock(&jobs.lock);
+        continue;
+      }
+
+      if (conn->closed)
+        continue;  // Closed by an earlier event of this batch, released after it
+
+      int broken = 0;
+      if (events[i].events & EPOLLIN) {
+        ssize_t received = read(conn->fd, conn->input + conn->used, sizeof(conn->input) - conn->used);
+        if (received > 0)
+          conn->used += received;
+        else if (received == 0)
+          conn->read_closed = 1;  // Still answer what was sent before the EOF
+        else if (errno != EAGAIN && errno != EINTR)
+          broken = 1;
+      } else if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        broken = 1;  // Gone in both directions, nobody to answer
+      }
+
+      pthread_mutex_lock(&jobs.lock);
+      if (broken)
+        close_connection(&loop, conn);
+      else
+        service_connection(&loop, conn);
+      pthread_mutex_unlock(&jobs.lock);
+    }
+
+    pthread_mutex_lock(&jobs.lock);  // No event of this batch refers to them any more
+    release_closed_connections(&loop);
+    pthread_mutex_unlock(&jobs.lock);
+  }
+
+  pthread_mutex_lock(&jobs.lock);  // Stop the workers; unanswered requests are dropped
+  jobs.stopping = 1;
+  pthread_cond_broadcast(&jobs.job_ready);
+  pthread_mutex_unlock(&jobs.lock);
+  for (int i = 0; i < num_workers; i++) {
+    pthread_join(workers[i], NULL);
+  }
+  free(workers);
+
+  // The workers are gone, so no lock is needed any more
+  while (loop.open) {
+    close_connection(&loop, loop.open);
+  }
+  release_closed_connections(&loop);
+  for (int i = 0; i < jobs.count; i++) {
+    release_connection(jobs.items[(jobs.head + i) % jobs.capacity].conn);
+  }
+  while (jobs.ready) {
+    Connection* next = jobs.ready->ready_next;
+    release_connection(jobs.ready);
+    jobs.ready = next;
+  }
+  free(jobs.items);
+  close(wake_fd);
+  close(loop.epoll_fd);
+  close(listen_fd);
+  unlink(path);
+  free_graph();
+  free_compressed_graph();
+  return 0;
+}
+
+int main(int argc, char* argv[]) {
+  const char* socket_path = NULL;
+  int num_workers = (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int emit = 0;
+  int all_pairs = 0;
+  const char* network = NULL;
+  const char* check = NULL;
+
+  // Options: --delta-stepping, --threads N, --delta N, --serve PATH, --workers N,
+  // --emit-tables, --all-pairs, --network FILE, --check-tables FILE
+  for (int i = 1; i < argc; i++) {
+    if (strcmp(argv[i], "--delta-stepping") == 0) {
+      search_threads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+      search_threads = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--delta") == 0 && i + 1 < argc) {
+      search_delta = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--serve") == 0 && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else if (strcmp(argv[i], "--workers") == 0 && i + 1 < argc) {
+      num_workers = atoi(argv[++i]);
+    } else if (strcmp(argv[i], "--emit-tables") == 0) {
+      emit = 1;
+    } else if (strcmp(argv[i], "--all-pairs") == 0) {
+      all_pairs = 1;
+    } else if (strcmp(argv[i], "--network") == 0 && i + 1 < argc) {
+      network = argv[++i];
+    } else if (strcmp(argv[i], "--check-tables") == 0 && i + 1 < argc) {
+      check = argv[++i];
+    } else {
+      printf("Usage: %s [--delta-stepping] [--threads N] [--delta N]\n"
+             "       %s --serve PATH [--workers N]\n"
+             "       %s --emit-tables [--all-pairs] [--network FILE|-] > trainsNetwork.h\n"
+             "       %s --check-tables FILE|-   (EMBEDDED_NETWORK builds)\n"
+             "Note: --delta-stepping and --threads never help with the %d built-in stations; the default\n"
+             "search is faster there. They are meant for networks of many thousands of stations.\n",
+             argv[0], argv[0], argv[0], argv[0], MAX_STATIONS);
+      return 1;
+    }
+  }
+  if (socket_path && search_threads > 0) {  // The daemon already runs one search per worker thread
+    printf("Error: --serve cannot be combined with --threads or --delta-stepping.\n");
+    return 1;
+  }
+
+  if (emit || check) {  // Generator mode, or checking embedded tables against a network description
+    unsigned int checksum = builtin_checksum();
+    const char* source = emit ? network : check;
+    FILE* in = !source ? NULL : (strcmp(source, "-") == 0 ? stdin : fopen(source, "r"));
+    if (source && !in) {
+      perror("Error: cannot open network description");
+      return 1;
+    }
+
+    int ok = 1;
+    if (in)
+      ok = read_network(in, &checksum);
+    else
+      initialize_graph();
+    if (in && in != stdin)
+      fclose(in);
+
+    if (ok && emit && compress_graph()) {
+      emit_tables(all_pairs, network, checksum);
+    } else if (ok && check) {
+#ifdef EMBEDDED_NETWORK
+      ok = checksum == EMBEDDED_CHECKSUM;
+      if (ok)
+        printf("trainsNetwork.h matches '%s'.\n", check);
+      else
+        fprintf(stderr, "Error: trainsNetwork.h was not generated from '%s'.\n", check);
+#else
+      fprintf(stderr, "Error: --check-tables needs a build with -DEMBEDDED_NETWORK.\n");
+      ok = 0;
+#endif
+    } else {
+      ok = 0;
+    }
+    free_graph();
+    free_compressed_graph();
+    return ok ? 0 : 1;
+  }
+
+#if defined(EMBEDDED_NETWORK) && defined(EMBEDDED_FROM_BUILTIN)
+  if (builtin_checksum() != EMBEDDED_CHECKSUM) {  // Refuse to route on tables of an older initialize_graph()
+    fprintf(stderr, "Error: trainsNetwork.h is out of date, regenerate it with --emit-tables.\n");
+    return 1;
+  }
+#endif
+
+  if (socket_path)  // Daemon mode: requests come from the socket instead of stdin
+    return serve(socket_path, num_workers);
+
+#ifndef EMBEDDED_NETWORK
+  initialize_graph();  // An EMBEDDED_NETWORK build starts with the compressed graph already in place
+#endif
 
   // Deal with disruptions
   int num_disruptions;  // no need to initialise, because of scanf below
@@ -335,10 +1709,25 @@ int main() {
       printf("Error: station '%s' does not exist.\n", to);
       continue;  // Skip removal
     }
+    load_adjacency_lists();  // Only does something the first time in an EMBEDDED_NETWORK build
     remove_edge(from, to);
   }
 
+  // The disruptions are known now, so the searches can run on the compressed graph
+  // and the adjacency lists are no longer needed
+  if (adjacency_lists_loaded) {
+    if (!compress_graph())
+      return 1;
+    free_graph();
+  }
+
+  if (search_threads > 0)  // Started once, reused by every query
+    search_pool = create_delta_stepping(search_threads);
+
   // Deal with queries
+  // A query is two station names, or a station name and a number of minutes for an isochrone.
+  // All isochrones share one workspace.
+  SearchWorkspace* ws = create_workspace();
   char from[50], to[50];
   while (1) {  // Don't know ahead of time how many queries
     scanf(" %49[^\n]", from);
@@ -346,6 +1735,23 @@ int main() {
       break;
     scanf(" %49[^\n]", to);
 
+    char* end;
+    long budget = strtol(to, &end, 10);
+    if (end != to && *end == '\0') {  // The second line is a number -> isochrone query
+      int start = get_station_index(from);
+      if (start == -1) {
+        printf("Error: station '%s' does not exist.\n", from);
+        continue;
+      }
+      if (budget < 0) {
+        printf("Error: time budget must not be negative.\n");
+        continue;
+      }
+      isochrone(ws, start, budget > INT_MAX ? INT_MAX : (int)budget);
+      print_isochrone(ws);
+      continue;
+    }
+
     int from_index = get_station_index(from);
     int to_index = get_station_index(to);
 
@@ -357,6 +1763,9 @@ int main() {
     dijkstra(from_index, to_index);
   }
 
-  free_graph();
+  free_workspace(ws);
+  if (search_pool)
+    free_delta_stepping(search_pool);
+  free_compressed_graph();
   return 0;
 }
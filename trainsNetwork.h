@@ -0,0 +1,71 @@
+// Generated by `trains --emit-tables --all-pairs` from initialize_graph(). Do not edit.
+// Included by trains.c when it is compiled with -DEMBEDDED_NETWORK.
+
+#if MAX_STATIONS != 12
+#error "trainsNetwork.h was generated for a different MAX_STATIONS"
+#endif
+
+#define EMBEDDED_CHECKSUM 0x973f9f37u
+#define EMBEDDED_FROM_BUILTIN
+#define EMBEDDED_ALL_PAIRS
+
+const char station_names[MAX_STATIONS][20] = {
+    "Amsterdam",
+    "Den Haag",
+    "Den Helder",
+    "Utrecht",
+    "Eindhoven",
+    "Nijmegen",
+    "Maastricht",
+    "Enschede",
+    "Zwolle",
+    "Groningen",
+    "Leeuwarden",
+    "Meppel"};
+
+static const int embedded_edge_start[MAX_STATIONS + 1] = {
+    0, 3, 5, 6, 9, 13, 16, 18, 19, 23, 25, 27,
+    30};
+
+static const int embedded_byte_start[MAX_STATIONS + 1] = {
+    0, 3, 5, 6, 9, 13, 16, 18, 19, 23, 25, 27,
+    30};
+
+static const unsigned char embedded_neighbours[] = {
+    1, 1, 1, 0, 4, 0, 0, 4, 4, 1, 2, 2,
+    1, 4, 2, 2, 4, 1, 8, 3, 2, 2, 4, 10,
+    1, 9, 2, 8, 1, 1};
+
+static const unsigned short embedded_travel_times[] = {
+    46, 77, 26, 46, 89, 77, 26, 47, 51, 89, 47, 55,
+    63, 55, 111, 77, 63, 111, 50, 51, 77, 50, 15, 34,
+    49, 34, 40, 15, 49, 40};
+
+static const int embedded_distances[MAX_STATIONS][MAX_STATIONS] = {
+    {0, 46, 77, 26, 73, 128, 136, 127, 77, 141, 132, 92},
+    {46, 0, 123, 72, 89, 144, 152, 173, 123, 187, 178, 138},
+    {77, 123, 0, 103, 150, 205, 213, 204, 154, 218, 209, 169},
+    {26, 72, 103, 0, 47, 102, 110, 101, 51, 115, 106, 66},
+    {73, 89, 150, 47, 0, 55, 63, 148, 98, 162, 153, 113},
+    {128, 144, 205, 102, 55, 0, 111, 127, 77, 141, 132, 92},
+    {136, 152, 213, 110, 63, 111, 0, 211, 161, 225, 216, 176},
+    {127, 173, 204, 101, 148, 127, 211, 0, 50, 114, 105, 65},
+    {77, 123, 154, 51, 98, 77, 161, 50, 0, 64, 55, 15},
+    {141, 187, 218, 115, 162, 141, 225, 114, 64, 0, 34, 49},
+    {132, 178, 209, 106, 153, 132, 216, 105, 55, 34, 0, 40},
+    {92, 138, 169, 66, 113, 92, 176, 65, 15, 49, 40, 0}};
+
+static const int embedded_previous[MAX_STATIONS][MAX_STATIONS] = {
+    {-1, 0, 0, 0, 3, 4, 4, 8, 3, 11, 11, 8},
+    {1, -1, 0, 0, 1, 4, 4, 8, 3, 11, 11, 8},
+    {2, 0, -1, 0, 3, 4, 4, 8, 3, 11, 11, 8},
+    {3, 0, 0, -1, 3, 4, 4, 8, 3, 11, 11, 8},
+    {3, 4, 0, 4, -1, 4, 4, 8, 3, 11, 11, 8},
+    {3, 4, 0, 4, 5, -1, 5, 8, 5, 11, 11, 8},
+    {3, 4, 0, 4, 6, 6, -1, 8, 3, 11, 11, 8},
+    {3, 0, 0, 8, 3, 8, 4, -1, 7, 11, 11, 8},
+    {3, 0, 0, 8, 3, 8, 4, 8, -1, 11, 11, 8},
+    {3, 0, 0, 8, 3, 8, 4, 8, 11, -1, 9, 9},
+    {3, 0, 0, 8, 3, 8, 4, 8, 11, 10, -1, 10},
+    {3, 0, 0, 8, 3, 8, 4, 8, 11, 11, 11, -1}};
+